@@ -2,11 +2,24 @@
 #define ROSNEURO_FILTERS_LAPLACIAN_HPP
 
 #include <regex>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <typeinfo>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <Eigen/Dense>
+#include <Eigen/Sparse>
 #include <gtest/gtest_prod.h>
 #include <rosneuro_filters/Filter.hpp>
 
 namespace rosneuro {
+    enum class LaplacianStrategy { Dense, Sparse, Stencil };
+
     template <typename T>
     class Laplacian : public Filter<T> {
         public:
@@ -23,6 +36,14 @@ namespace rosneuro {
             DynamicMatrix<int> layout(void) const;
             DynamicMatrix<T> mask(void) const;
 
+            // Run a micro-benchmark of the available strategies on frames of
+            // the given number of rows and select the fastest one. The result
+            // is cached per host in the tuning file (if any).
+            bool tune(unsigned int framesize);
+            void set_autotune(bool enable, const std::string& cachefile = "");
+            bool set_strategy(LaplacianStrategy strategy);
+            LaplacianStrategy strategy(void) const;
+
         private:
             bool load_layout(const std::string slayout);
             bool has_duplicate(const std::string slayout);
@@ -30,11 +51,32 @@ namespace rosneuro {
             bool create_mask(void);
             std::vector<int> get_neighbours(unsigned int rId, unsigned int cId);
 
+            void create_strategies(void);
+            void retune(void);
+            DynamicMatrix<T> apply_stencil(const DynamicMatrix<T>& in) const;
+            DynamicMatrix<T> apply_strategy(const DynamicMatrix<T>& in, LaplacianStrategy strategy) const;
+            double benchmark(LaplacianStrategy strategy, const DynamicMatrix<T>& frame) const;
+            std::string tuning_key(unsigned int framesize) const;
+            bool load_tuning(const std::string& key, LaplacianStrategy& strategy) const;
+            bool save_tuning(const std::string& key, LaplacianStrategy strategy) const;
+            std::string default_cachefile(void) const;
+            bool make_directories(const std::string& path) const;
+
             bool is_mask_set_;
             unsigned int nchannels_;
             DynamicMatrix<int> layout_;
             DynamicMatrix<T> mask_;
 
+            LaplacianStrategy strategy_;
+            Eigen::SparseMatrix<T> smask_;
+            std::vector<std::vector<unsigned int>> stencil_index_;
+            std::vector<std::vector<T>> stencil_weight_;
+
+            bool autotune_;
+            bool is_cache_writable_;
+            std::map<unsigned int, LaplacianStrategy> tuned_;
+            std::string cachefile_;
+
             FRIEND_TEST(LaplacianTestSuite, Constructor);
             FRIEND_TEST(LaplacianTestSuite, Configure);
             FRIEND_TEST(LaplacianTestSuite, SetLayoutDynamicMatrix);
@@ -51,12 +93,22 @@ namespace rosneuro {
             FRIEND_TEST(LaplacianTestSuite, LoadLayoutValid);
             FRIEND_TEST(LaplacianTestSuite, LoadLayoutInvalid);
             FRIEND_TEST(LaplacianTestSuite, LoadLayoutEmpty);
+            FRIEND_TEST(LaplacianTestSuite, ApplyStrategies);
+            FRIEND_TEST(LaplacianTestSuite, TuneWithCache);
+            FRIEND_TEST(LaplacianTestSuite, TuneUnwritableCache);
+            FRIEND_TEST(LaplacianTestSuite, ConfigureAutotune);
+            FRIEND_TEST(LaplacianTestSuite, ConfigureAutotuneDeferred);
+            FRIEND_TEST(LaplacianTestSuite, SetLayoutRetune);
+            FRIEND_TEST(LaplacianTestSuite, SetMaskRetune);
     };
 
     template<typename T>
     Laplacian<T>::Laplacian(void) {
         this->name_ = "laplacian";
         this->is_mask_set_ = true;
+        this->strategy_ = LaplacianStrategy::Dense;
+        this->autotune_ = false;
+        this->is_cache_writable_ = true;
     }
 
     template<typename T>
@@ -93,6 +145,20 @@ namespace rosneuro {
         }
 
         this->is_mask_set_ = true;
+
+        bool autotune = false;
+        std::string cachefile;
+        int framesize;
+        if (Filter<T>::getParam(std::string("autotune"), autotune) && autotune) {
+            if (!Filter<T>::getParam(std::string("tuning_cache"), cachefile))
+                cachefile = "";
+            this->set_autotune(true, cachefile);
+
+            // Without the frame size, tuning is postponed to the first apply
+            if (Filter<T>::getParam(std::string("framesize"), framesize) && framesize > 0)
+                this->tune(framesize);
+        }
+
         return retcod;
     }
 
@@ -108,6 +174,7 @@ namespace rosneuro {
         }
 
         this->is_mask_set_ = true;
+        this->retune();
         return true;
     }
 
@@ -132,13 +199,16 @@ namespace rosneuro {
         }
 
         this->is_mask_set_ = true;
+        this->retune();
         return true;
     }
 
     template<typename T>
     bool Laplacian<T>::set_mask(const DynamicMatrix<T>& mask) {
         this->mask_ = mask;
+        this->create_strategies();
         this->is_mask_set_ = true;
+        this->retune();
         return true;
     }
 
@@ -166,6 +236,7 @@ namespace rosneuro {
                 }
             }
         }
+        this->create_strategies();
         return true;
     }
 
@@ -273,7 +344,269 @@ namespace rosneuro {
             ROS_ERROR("[%s] Laplacian mask is not set", this->name().c_str());
             throw std::runtime_error("[" + this->name() + "] - Laplacian mask is not set");
         }
-        return in * this->mask_;
+
+        // Only the first frame of a given size is tuned: afterwards the
+        // decision is taken from memory and the cache file is not touched
+        if(this->autotune_) {
+            auto it = this->tuned_.find(in.rows());
+            if(it != this->tuned_.end())
+                this->strategy_ = it->second;
+            else
+                this->tune(in.rows());
+        }
+
+        return this->apply_strategy(in, this->strategy_);
+    }
+
+    template<typename T>
+    void Laplacian<T>::set_autotune(bool enable, const std::string& cachefile) {
+        this->autotune_  = enable;
+        this->cachefile_ = cachefile.empty() ? this->default_cachefile() : cachefile;
+        this->is_cache_writable_ = true;
+        this->tuned_.clear();
+    }
+
+    template<typename T>
+    bool Laplacian<T>::set_strategy(LaplacianStrategy strategy) {
+        this->strategy_ = strategy;
+        this->autotune_ = false;
+        return true;
+    }
+
+    template<typename T>
+    LaplacianStrategy Laplacian<T>::strategy(void) const {
+        return this->strategy_;
+    }
+
+    template<typename T>
+    void Laplacian<T>::create_strategies(void) {
+        unsigned int nrows = this->mask_.rows();
+        unsigned int ncols = this->mask_.cols();
+
+        this->smask_ = this->mask_.sparseView();
+        this->smask_.makeCompressed();
+
+        this->stencil_index_.assign(ncols, std::vector<unsigned int>());
+        this->stencil_weight_.assign(ncols, std::vector<T>());
+        for(auto j=0; j<ncols; j++) {
+            for(auto i=0; i<nrows; i++) {
+                if(this->mask_(i, j) != 0) {
+                    this->stencil_index_.at(j).push_back(i);
+                    this->stencil_weight_.at(j).push_back(this->mask_(i, j));
+                }
+            }
+        }
+    }
+
+    template<typename T>
+    void Laplacian<T>::retune(void) {
+        if(!this->autotune_)
+            return;
+
+        std::map<unsigned int, LaplacianStrategy> tuned;
+        tuned.swap(this->tuned_);
+        for(auto it=tuned.begin(); it!=tuned.end(); ++it) {
+            this->tune(it->first);
+        }
+    }
+
+    template<typename T>
+    DynamicMatrix<T> Laplacian<T>::apply_stencil(const DynamicMatrix<T>& in) const {
+        DynamicMatrix<T> out = DynamicMatrix<T>::Zero(in.rows(), this->stencil_index_.size());
+
+        for(auto j=0; j<this->stencil_index_.size(); j++) {
+            const std::vector<unsigned int>& index  = this->stencil_index_.at(j);
+            const std::vector<T>&            weight = this->stencil_weight_.at(j);
+            for(auto k=0; k<index.size(); k++) {
+                out.col(j) += weight.at(k) * in.col(index.at(k));
+            }
+        }
+        return out;
+    }
+
+    template<typename T>
+    DynamicMatrix<T> Laplacian<T>::apply_strategy(const DynamicMatrix<T>& in, LaplacianStrategy strategy) const {
+        switch(strategy) {
+            case LaplacianStrategy::Sparse:
+                return in * this->smask_;
+            case LaplacianStrategy::Stencil:
+                return this->apply_stencil(in);
+            case LaplacianStrategy::Dense:
+            default:
+                return in * this->mask_;
+        }
+    }
+
+    template<typename T>
+    double Laplacian<T>::benchmark(LaplacianStrategy strategy, const DynamicMatrix<T>& frame) const {
+        const unsigned int nrepetitions = 20;
+        const unsigned int nbatches     = 5;
+        double best = std::numeric_limits<double>::max();
+        DynamicMatrix<T> out;
+
+        // Warm-up
+        out = this->apply_strategy(frame, strategy);
+
+        for(auto b=0; b<nbatches; b++) {
+            auto start = std::chrono::steady_clock::now();
+            for(auto r=0; r<nrepetitions; r++) {
+                out = this->apply_strategy(frame, strategy);
+            }
+            auto stop = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::micro>(stop - start).count() / nrepetitions);
+        }
+        return best;
+    }
+
+    template<typename T>
+    bool Laplacian<T>::tune(unsigned int framesize) {
+        if(!this->is_mask_set_ || this->mask_.size() == 0) {
+            ROS_ERROR("[%s] Cannot tune: laplacian mask is not set", this->name().c_str());
+            return false;
+        }
+
+        if(this->cachefile_.empty())
+            this->cachefile_ = this->default_cachefile();
+
+        std::string key = this->tuning_key(framesize);
+
+        if(this->load_tuning(key, this->strategy_)) {
+            ROS_DEBUG("[%s] Using cached apply strategy %d", this->name().c_str(), (int)this->strategy_);
+            this->tuned_[framesize] = this->strategy_;
+            return true;
+        }
+
+        const LaplacianStrategy candidates[] = { LaplacianStrategy::Dense,
+                                                 LaplacianStrategy::Sparse,
+                                                 LaplacianStrategy::Stencil };
+        DynamicMatrix<T> frame = DynamicMatrix<T>::Random(framesize, this->mask_.rows());
+        double best = std::numeric_limits<double>::max();
+
+        for(auto it=std::begin(candidates); it!=std::end(candidates); ++it) {
+            double elapsed = this->benchmark(*it, frame);
+            ROS_DEBUG("[%s] Apply strategy %d: %f us", this->name().c_str(), (int)(*it), elapsed);
+            if(elapsed < best) {
+                best = elapsed;
+                this->strategy_ = *it;
+            }
+        }
+
+        this->tuned_[framesize] = this->strategy_;
+
+        // A failed save is remembered to avoid retrying (and warning) at every tuning
+        if(this->is_cache_writable_ && !this->save_tuning(key, this->strategy_)) {
+            ROS_WARN("[%s] Cannot write tuning cache '%s'", this->name().c_str(), this->cachefile_.c_str());
+            this->is_cache_writable_ = false;
+        }
+        return true;
+    }
+
+    template<typename T>
+    std::string Laplacian<T>::tuning_key(unsigned int framesize) const {
+        char hostname[256] = "unknown";
+        gethostname(hostname, sizeof(hostname) - 1);
+
+        // FNV-1a hash of the sparsity pattern of the mask, so that different
+        // layouts with the same number of channels have different entries
+        unsigned long long pattern = 14695981039346656037ULL;
+        for(auto j=0; j<this->mask_.cols(); j++) {
+            for(auto i=0; i<this->mask_.rows(); i++) {
+                pattern = (pattern ^ (this->mask_(i, j) != T(0))) * 1099511628211ULL;
+            }
+        }
+
+        std::stringstream ss;
+        ss << hostname << " " << typeid(T).name() << " " << framesize << " "
+           << this->mask_.rows() << " " << this->mask_.cols() << " " << std::hex << pattern;
+        return ss.str();
+    }
+
+    template<typename T>
+    bool Laplacian<T>::load_tuning(const std::string& key, LaplacianStrategy& strategy) const {
+        std::ifstream file(this->cachefile_);
+        std::string line;
+        const std::string prefix = key + " ";
+
+        while(std::getline(file, line)) {
+            if(line.compare(0, prefix.size(), prefix) == 0) {
+                int value = std::atoi(line.substr(prefix.size()).c_str());
+                if(value < (int)LaplacianStrategy::Dense || value > (int)LaplacianStrategy::Stencil)
+                    return false;
+                strategy = (LaplacianStrategy)value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<typename T>
+    bool Laplacian<T>::save_tuning(const std::string& key, LaplacianStrategy strategy) const {
+        std::vector<std::string> lines;
+        std::string line;
+        const std::string prefix = key + " ";
+
+        std::ifstream ifile(this->cachefile_);
+        while(std::getline(ifile, line)) {
+            if(line.compare(0, prefix.size(), prefix) != 0)
+                lines.push_back(line);
+        }
+        ifile.close();
+        lines.push_back(prefix + std::to_string((int)strategy));
+
+        std::string::size_type sep = this->cachefile_.find_last_of('/');
+        if(sep != std::string::npos && !this->make_directories(this->cachefile_.substr(0, sep)))
+            return false;
+
+        // Write a temporary file and atomically replace the cache, so that
+        // concurrent instances never see a truncated file
+        const std::string tmpfile = this->cachefile_ + "." + std::to_string(getpid()) + ".tmp";
+        std::ofstream ofile(tmpfile, std::ios::trunc);
+        if(!ofile.is_open())
+            return false;
+
+        for(auto it=lines.begin(); it!=lines.end(); ++it) {
+            ofile << *it << "\n";
+        }
+        ofile.close();
+
+        if(ofile.fail() || std::rename(tmpfile.c_str(), this->cachefile_.c_str()) != 0) {
+            std::remove(tmpfile.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    template<typename T>
+    std::string Laplacian<T>::default_cachefile(void) const {
+        const char* roshome = std::getenv("ROS_HOME");
+        const char* home    = std::getenv("HOME");
+        std::string path;
+
+        if(roshome != nullptr)
+            path = std::string(roshome);
+        else if(home != nullptr)
+            path = std::string(home) + "/.ros";
+        else
+            path = "/tmp";
+
+        if(!this->make_directories(path))
+            path = "/tmp";
+
+        return path + "/rosneuro_filters_laplacian_tuning.txt";
+    }
+
+    template<typename T>
+    bool Laplacian<T>::make_directories(const std::string& path) const {
+        struct stat info;
+        std::string::size_type pos = 0;
+
+        while(pos != std::string::npos) {
+            pos = path.find('/', pos + 1);
+            std::string current = path.substr(0, pos);
+            if(!current.empty() && stat(current.c_str(), &info) != 0)
+                mkdir(current.c_str(), 0755);
+        }
+        return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
     }
 }
 
@@ -9,6 +9,12 @@ namespace rosneuro {
             LaplacianTestSuite() { laplacian_filter = new Laplacian <double>(); }
             ~LaplacianTestSuite() { delete laplacian_filter; }
             Laplacian <double>* laplacian_filter = new Laplacian <double>();
+
+            std::string tuning_cache(void) {
+                const ::testing::TestInfo* info = ::testing::UnitTest::GetInstance()->current_test_info();
+                return "/tmp/rosneuro_filters_laplacian_" + std::string(info->name()) + "_" +
+                       std::to_string(getpid()) + ".txt";
+            }
     };
 
     TEST_F(LaplacianTestSuite, Constructor) {
@@ -164,6 +170,136 @@ namespace rosneuro {
         ASSERT_FALSE(laplacian_filter->load_layout(invalid_layout));
     }
 
+    TEST_F(LaplacianTestSuite, ApplyStrategies) {
+        std::string layout = "0 1 0; 2 3 4; 5 6 7";
+        int nchannels = 7;
+        ASSERT_TRUE(laplacian_filter->set_layout(layout, nchannels));
+
+        DynamicMatrix<double> in = DynamicMatrix<double>::Random(16, nchannels);
+        DynamicMatrix<double> expected = in * laplacian_filter->mask();
+
+        ASSERT_TRUE(laplacian_filter->set_strategy(LaplacianStrategy::Sparse));
+        ASSERT_EQ(laplacian_filter->strategy(), LaplacianStrategy::Sparse);
+        ASSERT_TRUE(laplacian_filter->apply(in).isApprox(expected, 1e-12));
+
+        ASSERT_TRUE(laplacian_filter->set_strategy(LaplacianStrategy::Stencil));
+        ASSERT_EQ(laplacian_filter->strategy(), LaplacianStrategy::Stencil);
+        ASSERT_TRUE(laplacian_filter->apply(in).isApprox(expected, 1e-12));
+
+        ASSERT_TRUE(laplacian_filter->set_strategy(LaplacianStrategy::Dense));
+        ASSERT_EQ(laplacian_filter->apply(in), expected);
+    }
+
+    TEST_F(LaplacianTestSuite, TuneWithCache) {
+        std::string cachefile = tuning_cache();
+
+        ASSERT_TRUE(laplacian_filter->set_layout("1 2 3; 4 5 6; 7 8 9", 9));
+        laplacian_filter->set_autotune(true, cachefile);
+        ASSERT_TRUE(laplacian_filter->tune(32));
+        ASSERT_EQ(laplacian_filter->tuned_.count(32), 1);
+
+        LaplacianStrategy cached;
+        ASSERT_TRUE(laplacian_filter->load_tuning(laplacian_filter->tuning_key(32), cached));
+        ASSERT_EQ(cached, laplacian_filter->strategy());
+
+        ASSERT_TRUE(laplacian_filter->save_tuning(laplacian_filter->tuning_key(32), LaplacianStrategy::Stencil));
+        ASSERT_TRUE(laplacian_filter->tune(32));
+        ASSERT_EQ(laplacian_filter->strategy(), LaplacianStrategy::Stencil);
+
+        DynamicMatrix<double> in = DynamicMatrix<double>::Random(8, 9);
+        ASSERT_TRUE(laplacian_filter->apply(in).isApprox(in * laplacian_filter->mask(), 1e-12));
+        ASSERT_EQ(laplacian_filter->tuned_.count(8), 1);
+
+        // Same shape and number of non-zeros, but a different layout
+        std::string key = laplacian_filter->tuning_key(8);
+        ASSERT_TRUE(laplacian_filter->set_layout("1 2 3; 4 5 6; 7 9 8", 9));
+        ASSERT_NE(laplacian_filter->tuning_key(8), key);
+
+        std::remove(cachefile.c_str());
+    }
+
+    TEST_F(LaplacianTestSuite, TuneUnwritableCache) {
+        ASSERT_TRUE(laplacian_filter->set_layout("1 2 3; 4 5 6; 7 8 9", 9));
+        laplacian_filter->set_autotune(true, "/proc/rosneuro_filters_laplacian/tuning.txt");
+        ASSERT_TRUE(laplacian_filter->tune(32));
+        ASSERT_FALSE(laplacian_filter->is_cache_writable_);
+        ASSERT_EQ(laplacian_filter->tuned_.count(32), 1);
+    }
+
+    TEST_F(LaplacianTestSuite, ConfigureAutotune) {
+        std::string cachefile = tuning_cache();
+
+        laplacian_filter->params_["layout"]       = XmlRpc::XmlRpcValue(std::string("1 2 3; 4 5 6; 7 8 9"));
+        laplacian_filter->params_["autotune"]     = XmlRpc::XmlRpcValue(true);
+        laplacian_filter->params_["tuning_cache"] = XmlRpc::XmlRpcValue(cachefile);
+        laplacian_filter->params_["framesize"]    = XmlRpc::XmlRpcValue(32);
+        ASSERT_TRUE(laplacian_filter->configure());
+
+        ASSERT_TRUE(laplacian_filter->autotune_);
+        ASSERT_EQ(laplacian_filter->cachefile_, cachefile);
+        ASSERT_EQ(laplacian_filter->tuned_.count(32), 1);
+
+        LaplacianStrategy cached;
+        ASSERT_TRUE(laplacian_filter->load_tuning(laplacian_filter->tuning_key(32), cached));
+        ASSERT_EQ(cached, laplacian_filter->strategy());
+
+        std::remove(cachefile.c_str());
+    }
+
+    TEST_F(LaplacianTestSuite, ConfigureAutotuneDeferred) {
+        std::string cachefile = tuning_cache();
+
+        laplacian_filter->params_["layout"]       = XmlRpc::XmlRpcValue(std::string("1 2 3; 4 5 6; 7 8 9"));
+        laplacian_filter->params_["autotune"]     = XmlRpc::XmlRpcValue(true);
+        laplacian_filter->params_["tuning_cache"] = XmlRpc::XmlRpcValue(cachefile);
+        ASSERT_TRUE(laplacian_filter->configure());
+
+        ASSERT_TRUE(laplacian_filter->autotune_);
+        ASSERT_TRUE(laplacian_filter->tuned_.empty());
+
+        DynamicMatrix<double> in = DynamicMatrix<double>::Random(16, 9);
+        ASSERT_TRUE(laplacian_filter->apply(in).isApprox(in * laplacian_filter->mask(), 1e-12));
+        ASSERT_EQ(laplacian_filter->tuned_.size(), 1);
+        ASSERT_EQ(laplacian_filter->tuned_.count(16), 1);
+
+        std::remove(cachefile.c_str());
+    }
+
+    TEST_F(LaplacianTestSuite, SetLayoutRetune) {
+        std::string cachefile = tuning_cache();
+
+        ASSERT_TRUE(laplacian_filter->set_layout("1 2 3; 4 5 6; 7 8 9", 9));
+        laplacian_filter->set_autotune(true, cachefile);
+        ASSERT_TRUE(laplacian_filter->tune(32));
+
+        ASSERT_TRUE(laplacian_filter->set_layout("0 1 0; 2 3 4; 5 6 7", 7));
+        ASSERT_EQ(laplacian_filter->tuned_.count(32), 1);
+
+        LaplacianStrategy cached;
+        ASSERT_TRUE(laplacian_filter->load_tuning(laplacian_filter->tuning_key(32), cached));
+        ASSERT_EQ(cached, laplacian_filter->tuned_.at(32));
+
+        std::remove(cachefile.c_str());
+    }
+
+    TEST_F(LaplacianTestSuite, SetMaskRetune) {
+        std::string cachefile = tuning_cache();
+
+        ASSERT_TRUE(laplacian_filter->set_layout("1 2 3; 4 5 6; 7 8 9", 9));
+        laplacian_filter->set_autotune(true, cachefile);
+        ASSERT_TRUE(laplacian_filter->tune(32));
+
+        DynamicMatrix<double> mask = DynamicMatrix<double>::Identity(9, 9);
+        ASSERT_TRUE(laplacian_filter->set_mask(mask));
+        ASSERT_EQ(laplacian_filter->tuned_.count(32), 1);
+
+        LaplacianStrategy cached;
+        ASSERT_TRUE(laplacian_filter->load_tuning(laplacian_filter->tuning_key(32), cached));
+        ASSERT_EQ(cached, laplacian_filter->tuned_.at(32));
+
+        std::remove(cachefile.c_str());
+    }
+
     TEST_F(LaplacianTestSuite, Integration){
         std::string base_path = ros::package::getPath("rosneuro_filters_laplacian");
         int frame_size = 32;
@@ -0,0 +1,284 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <unistd.h>
+#include "Laplacian.hpp"
+
+#ifndef LAPLACIAN_BENCHMARK_REPORT_DIR
+#define LAPLACIAN_BENCHMARK_REPORT_DIR "."
+#endif
+
+namespace rosneuro {
+
+    struct Montage {
+        std::string name;
+        std::string layout;
+        int nchannels;
+    };
+
+    struct BenchmarkRecord {
+        std::string montage;
+        std::string precision;
+        std::string strategy;
+        int nchannels;
+        int framesize;
+        double max_error;
+        double us_per_frame;
+        double samples_per_second;
+    };
+
+    static std::vector<BenchmarkRecord> records;
+
+    class LaplacianBenchmarkSuite : public ::testing::Test {
+        public:
+            LaplacianBenchmarkSuite() {
+                montages.push_back({"grid16", " 0  0  1  0  0;"
+                                              " 2  3  4  5  6;"
+                                              " 7  8  9 10 11;"
+                                              "12 13 14 15 16", 16});
+                montages.push_back({"eeg32",  " 0   0   1   0   2   0   0;"
+                                              " 0   0   0   0   0   0   0;"
+                                              " 0   0  18   3  19   0   0;"
+                                              " 4  20   5  21   6  22   7;"
+                                              "23   8  24   9  25  10  26;"
+                                              "11  27  12   0  13  28  14;"
+                                              "29  15  30  16  31  17  32", 32});
+                montages.push_back({"grid64", grid_layout(8, 8), 64});
+                montages.push_back({"grid128", grid_layout(8, 16), 128});
+            }
+
+            static std::string grid_layout(int nrows, int ncols) {
+                std::stringstream ss;
+                for(auto i=0; i<nrows; i++) {
+                    for(auto j=0; j<ncols; j++) {
+                        ss << i*ncols + j + 1 << " ";
+                    }
+                    if(i < nrows - 1)
+                        ss << ";";
+                }
+                return ss.str();
+            }
+
+            std::vector<Montage> montages;
+            std::vector<int> framesizes = {1, 32, 512};
+            int nsamples = 4096;
+    };
+
+    // Reference mask computed independently from the filter implementation
+    DynamicMatrix<double> reference_mask(const std::string& slayout, int nchannels) {
+        std::vector<std::vector<int>> layout;
+        std::stringstream ss(slayout);
+        std::string srow;
+        while(std::getline(ss, srow, ';')) {
+            std::stringstream iss(srow);
+            std::vector<int> row;
+            int index;
+            while(iss >> index) {
+                row.push_back(index);
+            }
+            layout.push_back(row);
+        }
+
+        int nrows = layout.size();
+        int ncols = layout.at(0).size();
+        DynamicMatrix<double> mask = DynamicMatrix<double>::Zero(nchannels, nchannels);
+        const int dr[] = {0, 0, -1, 1};
+        const int dc[] = {-1, 1, 0, 0};
+
+        for(auto i=0; i<nrows; i++) {
+            for(auto j=0; j<ncols; j++) {
+                int channel = layout[i][j];
+                if(channel == 0)
+                    continue;
+
+                std::vector<int> neighbours;
+                for(auto k=0; k<4; k++) {
+                    int r = i + dr[k];
+                    int c = j + dc[k];
+                    if(r >= 0 && r < nrows && c >= 0 && c < ncols && layout[r][c] != 0)
+                        neighbours.push_back(layout[r][c]);
+                }
+
+                mask(channel - 1, channel - 1) = 1.0;
+                for(auto it=neighbours.begin(); it!=neighbours.end(); ++it) {
+                    mask(*it - 1, channel - 1) = -1.0 / neighbours.size();
+                }
+            }
+        }
+        return mask;
+    }
+
+    // Synthetic multichannel signal: per-channel alpha/beta rhythms, a shared
+    // common-mode component and white noise
+    DynamicMatrix<double> synthetic_signal(int nsamples, int nchannels, unsigned int seed) {
+        const double samplerate = 512.0;
+        std::mt19937 generator(seed);
+        std::normal_distribution<double> noise(0.0, 1.0);
+        std::uniform_real_distribution<double> phase(0.0, 2.0 * M_PI);
+        DynamicMatrix<double> signal(nsamples, nchannels);
+
+        for(auto j=0; j<nchannels; j++) {
+            double alpha = phase(generator);
+            double beta  = phase(generator);
+            for(auto i=0; i<nsamples; i++) {
+                double t = i / samplerate;
+                signal(i, j) = 20.0 * std::sin(2.0 * M_PI * 10.0 * t + alpha)
+                             +  5.0 * std::sin(2.0 * M_PI * 22.0 * t + beta)
+                             + 50.0 * std::sin(2.0 * M_PI * 50.0 * t)
+                             +  2.0 * noise(generator);
+            }
+        }
+        return signal;
+    }
+
+    std::string strategy_name(LaplacianStrategy strategy) {
+        switch(strategy) {
+            case LaplacianStrategy::Sparse:  return "sparse";
+            case LaplacianStrategy::Stencil: return "stencil";
+            case LaplacianStrategy::Dense:
+            default:                         return "dense";
+        }
+    }
+
+    template<typename T>
+    double run_frames(Laplacian<T>& laplacian, const DynamicMatrix<T>& data, int framesize,
+                      DynamicMatrix<T>& output) {
+        int nframes = data.rows() / framesize;
+        output = DynamicMatrix<T>::Zero(data.rows(), data.cols());
+
+        // Warm-up
+        output.topRows(framesize) = laplacian.apply(data.topRows(framesize));
+
+        auto start = std::chrono::steady_clock::now();
+        for(auto i=0; i<nframes*framesize; i = i+framesize) {
+            output.middleRows(i, framesize) = laplacian.apply(data.middleRows(i, framesize));
+        }
+        auto stop = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double>(stop - start).count();
+    }
+
+    template<typename T>
+    void run_montage(const Montage& montage, const std::vector<int>& framesizes, int nsamples,
+                     const std::string& precision, double tolerance) {
+        const LaplacianStrategy strategies[] = { LaplacianStrategy::Dense,
+                                                 LaplacianStrategy::Sparse,
+                                                 LaplacianStrategy::Stencil };
+
+        DynamicMatrix<double> input    = synthetic_signal(nsamples, montage.nchannels, montage.nchannels);
+        DynamicMatrix<double> expected = input * reference_mask(montage.layout, montage.nchannels);
+        DynamicMatrix<T>      data     = input.cast<T>();
+
+        Laplacian<T> laplacian;
+        ASSERT_TRUE(laplacian.set_layout(montage.layout, montage.nchannels));
+
+        for(auto fit=framesizes.begin(); fit!=framesizes.end(); ++fit) {
+            int framesize = *fit;
+            int nframes   = nsamples / framesize;
+
+            for(auto sit=std::begin(strategies); sit!=std::end(strategies); ++sit) {
+                ASSERT_TRUE(laplacian.set_strategy(*sit));
+                DynamicMatrix<T> output;
+
+                double elapsed   = run_frames(laplacian, data, framesize, output);
+                double max_error = (output.template cast<double>() - expected).cwiseAbs().maxCoeff()
+                                 / expected.cwiseAbs().maxCoeff();
+
+                EXPECT_LT(max_error, tolerance) << "montage: " << montage.name
+                                                << ", precision: " << precision
+                                                << ", strategy: " << strategy_name(*sit)
+                                                << ", framesize: " << framesize;
+
+                records.push_back({montage.name, precision, strategy_name(*sit), montage.nchannels,
+                                   framesize, max_error, 1e6 * elapsed / nframes,
+                                   nframes * framesize / elapsed});
+            }
+        }
+
+        // Autotuned run, i.e., the strategy actually used when autotune is enabled
+        const int framesize = 32;
+        const int nframes   = nsamples / framesize;
+        const std::string cachefile = std::string(LAPLACIAN_BENCHMARK_REPORT_DIR) + "/laplacian_tuning_"
+                                    + montage.name + "_" + precision + "_" + std::to_string(getpid()) + ".txt";
+        DynamicMatrix<T> output;
+
+        laplacian.set_autotune(true, cachefile);
+        ASSERT_TRUE(laplacian.tune(framesize));
+        double elapsed   = run_frames(laplacian, data, framesize, output);
+        double max_error = (output.template cast<double>() - expected).cwiseAbs().maxCoeff()
+                         / expected.cwiseAbs().maxCoeff();
+        std::remove(cachefile.c_str());
+
+        EXPECT_LT(max_error, tolerance) << "montage: " << montage.name
+                                        << ", precision: " << precision
+                                        << ", strategy: autotuned (" << strategy_name(laplacian.strategy()) << ")"
+                                        << ", framesize: " << framesize;
+
+        records.push_back({montage.name, precision, "autotuned:" + strategy_name(laplacian.strategy()),
+                           montage.nchannels, framesize, max_error, 1e6 * elapsed / nframes,
+                           nframes * framesize / elapsed});
+    }
+
+    // Non-finite values are not valid JSON numbers
+    std::string json_number(double value) {
+        if(!std::isfinite(value))
+            return "null";
+
+        std::stringstream ss;
+        ss << std::setprecision(std::numeric_limits<double>::max_digits10) << value;
+        return ss.str();
+    }
+
+    bool write_report(const std::string& path) {
+        std::ofstream file(path, std::ios::trunc);
+        if(!file.is_open())
+            return false;
+
+        file << "{\n  \"benchmarks\": [\n";
+        for(auto it=records.begin(); it!=records.end(); ++it) {
+            file << "    {\"montage\": \"" << it->montage << "\", "
+                 << "\"precision\": \"" << it->precision << "\", "
+                 << "\"strategy\": \"" << it->strategy << "\", "
+                 << "\"nchannels\": " << it->nchannels << ", "
+                 << "\"framesize\": " << it->framesize << ", "
+                 << "\"max_error\": " << json_number(it->max_error) << ", "
+                 << "\"us_per_frame\": " << json_number(it->us_per_frame) << ", "
+                 << "\"samples_per_second\": " << json_number(it->samples_per_second) << "}"
+                 << (it + 1 != records.end() ? ",\n" : "\n");
+        }
+        file << "  ]\n}\n";
+        return file.good();
+    }
+
+    TEST_F(LaplacianBenchmarkSuite, GoldenDouble) {
+        for(auto it=montages.begin(); it!=montages.end(); ++it) {
+            run_montage<double>(*it, framesizes, nsamples, "double", 1e-12);
+        }
+    }
+
+    TEST_F(LaplacianBenchmarkSuite, GoldenFloat) {
+        for(auto it=montages.begin(); it!=montages.end(); ++it) {
+            run_montage<float>(*it, framesizes, nsamples, "float", 1e-5);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    int retcod = RUN_ALL_TESTS();
+
+    const char* report = std::getenv("LAPLACIAN_BENCHMARK_REPORT");
+    std::string path = report != nullptr ? report
+                                          : std::string(LAPLACIAN_BENCHMARK_REPORT_DIR) + "/laplacian_benchmark.json";
+    if(rosneuro::write_report(path))
+        std::cout << "Benchmark report written to '" << path << "'" << std::endl;
+    else
+        std::cerr << "[WARNING] Cannot write benchmark report '" << path << "'" << std::endl;
+
+    return retcod;
+}